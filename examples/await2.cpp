@@ -1,29 +1,15 @@
 #include <chrono>
 #include <iostream>
-#include <thread>
 #include "rexp/await.hpp"
 #include "rexp/future.hpp"
 #include "rexp/spawn.hpp"
+#include "rexp/timer_service.hpp"
 
 using rexp::await;
 using rexp::future;
-using rexp::promise;
+using rexp::sleep_for;
 using rexp::spawn;
 
-future<void> sleep_for(std::chrono::milliseconds ms)
-{
-  promise<void> p;
-  future<void> f = p.get_future();
-
-  std::thread([ms, p = std::move(p)]() mutable
-      {
-        std::this_thread::sleep_for(ms);
-        p.set_value();
-      }).detach();
-
-  return f;
-}
-
 future<void> print_1_to(int n)
 {
   return spawn([n]
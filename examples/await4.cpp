@@ -6,17 +6,21 @@
 #include "rexp/spawn.hpp"
 #include "rexp/use_await.hpp"
 
-using rexp::spawn;
+using rexp::spawn_detached;
 using rexp::use_await;
 using boost::asio::ip::tcp;
 
 resumable void echo(tcp::socket socket)
 {
+  boost::system::error_code ec;
   for (;;)
   {
     char data[1024];
-    std::size_t n = socket.async_read_some(boost::asio::buffer(data), use_await);
-    boost::asio::async_write(socket, boost::asio::buffer(data, n), use_await);
+    std::size_t n = socket.async_read_some(boost::asio::buffer(data),
+        use_await[ec].with_timeout(socket, std::chrono::seconds(30)));
+    if (ec) break;
+    boost::asio::async_write(socket, boost::asio::buffer(data, n), use_await[ec]);
+    if (ec) break;
   }
 }
 
@@ -28,7 +32,7 @@ resumable void listen(tcp::acceptor acceptor)
     {
       tcp::socket socket(acceptor.get_io_service());
       acceptor.async_accept(socket, use_await);
-      spawn([s = std::move(socket)]() mutable { echo(std::move(s)); });
+      spawn_detached([s = std::move(socket)]() mutable { echo(std::move(s)); });
     }
     catch (...)
     {
@@ -39,6 +43,6 @@ resumable void listen(tcp::acceptor acceptor)
 int main()
 {
   boost::asio::io_service io_service;
-  spawn([&]{ listen({io_service, {tcp::v4(), 55555}}); });
+  spawn_detached([&]{ listen({io_service, {tcp::v4(), 55555}}); });
   io_service.run();
 }
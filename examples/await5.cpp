@@ -0,0 +1,92 @@
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <new>
+#include "rexp/await.hpp"
+#include "rexp/future.hpp"
+#include "rexp/spawn.hpp"
+#include "rexp/timer_service.hpp"
+
+using rexp::await;
+using rexp::future;
+using rexp::sleep_for;
+using rexp::spawn;
+
+class arena
+{
+public:
+  explicit arena(std::size_t size)
+    : buffer_(new char[size]), size_(size)
+  {
+  }
+
+  void* allocate(std::size_t n)
+  {
+    n = (n + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+    if (used_ + n > size_)
+      throw std::bad_alloc();
+    void* p = buffer_.get() + used_;
+    used_ += n;
+    return p;
+  }
+
+  std::size_t used() const
+  {
+    return used_;
+  }
+
+private:
+  std::unique_ptr<char[]> buffer_;
+  std::size_t size_;
+  std::size_t used_ = 0;
+};
+
+template <class T>
+struct arena_allocator
+{
+  typedef T value_type;
+
+  explicit arena_allocator(arena& a) : arena_(&a) {}
+
+  template <class U>
+  arena_allocator(const arena_allocator<U>& other) : arena_(other.arena_) {}
+
+  T* allocate(std::size_t n)
+  {
+    return static_cast<T*>(arena_->allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T*, std::size_t)
+  {
+  }
+
+  template <class U>
+  bool operator==(const arena_allocator<U>& other) const
+  {
+    return arena_ == other.arena_;
+  }
+
+  template <class U>
+  bool operator!=(const arena_allocator<U>& other) const
+  {
+    return arena_ != other.arena_;
+  }
+
+  arena* arena_;
+};
+
+int main()
+{
+  arena request_arena(1024 * 1024);
+  arena_allocator<char> alloc(request_arena);
+
+  future<int> f = spawn(std::allocator_arg, alloc, []
+      {
+        await(sleep_for(std::chrono::milliseconds(100)));
+        return 42;
+      });
+
+  std::cout << f.get() << std::endl;
+  std::cout << request_arena.used() << " bytes from arena" << std::endl;
+}
@@ -0,0 +1,75 @@
+#include <iostream>
+#include <iterator>
+#include <vector>
+#include "rexp/channel.hpp"
+#include "rexp/spawn.hpp"
+#include "rexp/thread_pool.hpp"
+
+using rexp::channel;
+using rexp::channel_closed;
+using rexp::spawn;
+using rexp::thread_pool;
+
+resumable void produce(channel<int>& out, int n)
+{
+  std::vector<int> batch;
+  for (int i = 1; i <= n; ++i)
+  {
+    batch.push_back(i);
+    if (batch.size() == 10)
+    {
+      out.send(batch.begin(), batch.end());
+      batch.clear();
+    }
+  }
+  out.send(batch.begin(), batch.end());
+  out.close();
+}
+
+resumable void square(channel<int>& in, channel<long>& out)
+{
+  try
+  {
+    for (;;)
+    {
+      long v = in.receive();
+      out.send(v * v);
+    }
+  }
+  catch (channel_closed&)
+  {
+  }
+  out.close();
+}
+
+resumable long consume(channel<long>& in)
+{
+  long total = 0;
+  try
+  {
+    for (;;)
+    {
+      long values[16];
+      std::size_t n = in.receive(values, 16);
+      for (std::size_t i = 0; i < n; ++i)
+        total += values[i];
+    }
+  }
+  catch (channel_closed&)
+  {
+  }
+  return total;
+}
+
+int main()
+{
+  thread_pool pool(4);
+  channel<int> numbers(8);
+  channel<long> squares(8);
+
+  auto total = spawn(pool, [&]{ return consume(squares); });
+  spawn(pool, [&]{ square(numbers, squares); });
+  spawn(pool, [&]{ produce(numbers, 100000); });
+
+  std::cout << total.get() << std::endl;
+}
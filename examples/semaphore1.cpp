@@ -0,0 +1,49 @@
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include "rexp/async_mutex.hpp"
+#include "rexp/async_semaphore.hpp"
+#include "rexp/await.hpp"
+#include "rexp/spawn.hpp"
+#include "rexp/task_group.hpp"
+#include "rexp/timer_service.hpp"
+
+using rexp::async_mutex;
+using rexp::async_semaphore;
+using rexp::await;
+using rexp::sleep_for;
+using rexp::spawn;
+using rexp::task_group;
+
+async_semaphore backend_slots(3);
+async_mutex output_mutex;
+int in_flight = 0;
+
+resumable void call_backend(int i)
+{
+  backend_slots.acquire();
+  {
+    std::lock_guard<async_mutex> lock(output_mutex);
+    std::cout << "request " << i << " started, "
+      << ++in_flight << " in flight" << std::endl;
+  }
+
+  await(sleep_for(std::chrono::milliseconds(50)));
+
+  {
+    std::lock_guard<async_mutex> lock(output_mutex);
+    --in_flight;
+  }
+  backend_slots.release();
+}
+
+int main()
+{
+  spawn([]
+      {
+        task_group group;
+        for (int i = 0; i < 10; ++i)
+          group.spawn([i]{ call_backend(i); });
+        group.join();
+      }).get();
+}
@@ -0,0 +1,37 @@
+#include <iostream>
+#include <vector>
+#include "rexp/await.hpp"
+#include "rexp/future.hpp"
+#include "rexp/sharded_runtime.hpp"
+#include "rexp/spawn.hpp"
+
+using rexp::await;
+using rexp::future;
+using rexp::sharded_runtime;
+using rexp::spawn;
+
+sharded_runtime runtime(4);
+
+resumable int ping(std::size_t home, int n)
+{
+  int total = 0;
+  for (int i = 0; i < n; ++i)
+  {
+    auto& peer = runtime.at((home + 1 + i) % runtime.size());
+    total += await(spawn(peer, [i]{ return i; }));
+
+    if (sharded_runtime::shard::current() != &runtime.at(home))
+      throw std::logic_error("waiter migrated off its home shard");
+  }
+  return total;
+}
+
+int main()
+{
+  std::vector<future<int>> results;
+  for (std::size_t i = 0; i < runtime.size(); ++i)
+    results.push_back(spawn(runtime.at(i), [i]{ return ping(i, 1000); }));
+
+  for (auto& f: results)
+    std::cout << f.get() << std::endl;
+}
@@ -0,0 +1,55 @@
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include "rexp/await.hpp"
+#include "rexp/spawn.hpp"
+#include "rexp/task_group.hpp"
+#include "rexp/timer_service.hpp"
+
+using rexp::await;
+using rexp::sleep_for;
+using rexp::spawn;
+using rexp::task_group;
+
+resumable int query_backend(int i)
+{
+  await(sleep_for(std::chrono::milliseconds(10 * (i % 5))));
+  if (i == 13)
+    throw std::runtime_error("backend 13 failed");
+  return i * i;
+}
+
+resumable void scatter_gather(int n)
+{
+  std::vector<int> results(n);
+  task_group group;
+
+  for (int i = 0; i < n; ++i)
+    group.spawn([i, &results, &group]
+        {
+          if (!group.cancelled())
+            results[i] = query_backend(i);
+        });
+
+  group.join();
+
+  int total = 0;
+  for (int r: results)
+    total += r;
+  std::cout << "total " << total << std::endl;
+}
+
+int main()
+{
+  spawn([]{ scatter_gather(10); }).get();
+
+  try
+  {
+    spawn([]{ scatter_gather(20); }).get();
+  }
+  catch (std::exception& e)
+  {
+    std::cout << "error: " << e.what() << std::endl;
+  }
+}
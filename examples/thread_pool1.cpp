@@ -0,0 +1,35 @@
+#include <iostream>
+#include <vector>
+#include "rexp/await.hpp"
+#include "rexp/future.hpp"
+#include "rexp/spawn.hpp"
+#include "rexp/thread_pool.hpp"
+
+using rexp::await;
+using rexp::future;
+using rexp::spawn;
+using rexp::thread_pool;
+
+thread_pool pool;
+
+resumable long fib(int n)
+{
+  if (n < 2)
+    return n;
+  if (n < 20)
+    return fib(n - 1) + fib(n - 2);
+
+  future<long> a = spawn(pool, [n]{ return fib(n - 1); });
+  long b = fib(n - 2);
+  return await(std::move(a)) + b;
+}
+
+int main()
+{
+  std::vector<future<long>> results;
+  for (int i = 20; i < 30; ++i)
+    results.push_back(spawn(pool, [i]{ return fib(i); }));
+
+  for (auto& f: results)
+    std::cout << f.get() << std::endl;
+}
@@ -0,0 +1,85 @@
+//
+// async_mutex.hpp
+// ~~~~~~~~~~~~~~~
+// Mutex that suspends only the waiter that is blocked on it.
+//
+// Copyright (c) 2015 Christopher M. Kohlhoff (chris at kohlhoff dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef RESUMABLE_EXPRESSIONS_ASYNC_MUTEX_HPP
+#define RESUMABLE_EXPRESSIONS_ASYNC_MUTEX_HPP
+
+#include <cassert>
+#include <mutex>
+#include "rexp/detail/wait_queue.hpp"
+#include "rexp/waiter.hpp"
+
+namespace rexp {
+
+// Ownership passes directly from unlock() to the longest-waiting locker, so
+// waiters acquire the mutex in FIFO order. Satisfies BasicLockable, so it may
+// be used with std::lock_guard and std::unique_lock inside a waiter.
+class async_mutex
+{
+public:
+  async_mutex() {}
+
+  async_mutex(const async_mutex&) = delete;
+  async_mutex& operator=(const async_mutex&) = delete;
+
+  bool try_lock()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (locked_)
+      return false;
+    locked_ = true;
+    return true;
+  }
+
+  resumable void lock()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!locked_)
+    {
+      locked_ = true;
+      return;
+    }
+
+    waiter* this_waiter = waiter::active();
+    assert(this_waiter != nullptr);
+
+    detail::wait_node n;
+    n.waiter_ = this_waiter->shared_from_this();
+    waiters_.push(&n);
+    lock.unlock();
+    this_waiter->suspend("async_mutex");
+  }
+
+  void unlock()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    assert(locked_);
+    if (detail::wait_node* n = waiters_.pop())
+    {
+      std::shared_ptr<waiter> w(std::move(n->waiter_));
+      lock.unlock();
+      w->resume();
+    }
+    else
+    {
+      locked_ = false;
+    }
+  }
+
+private:
+  std::mutex mutex_;
+  detail::wait_queue waiters_;
+  bool locked_ = false;
+};
+
+} // namespace rexp
+
+#endif // RESUMABLE_EXPRESSIONS_ASYNC_MUTEX_HPP
@@ -0,0 +1,94 @@
+//
+// async_semaphore.hpp
+// ~~~~~~~~~~~~~~~~~~~
+// Counting semaphore that suspends only the waiter that is blocked on it.
+//
+// Copyright (c) 2015 Christopher M. Kohlhoff (chris at kohlhoff dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef RESUMABLE_EXPRESSIONS_ASYNC_SEMAPHORE_HPP
+#define RESUMABLE_EXPRESSIONS_ASYNC_SEMAPHORE_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <mutex>
+#include "rexp/detail/wait_queue.hpp"
+#include "rexp/waiter.hpp"
+
+namespace rexp {
+
+// Released permits are handed directly to suspended waiters in FIFO order,
+// so a permit is only ever counted as available when nobody is waiting.
+class async_semaphore
+{
+public:
+  explicit async_semaphore(std::size_t permits)
+    : permits_(permits)
+  {
+  }
+
+  async_semaphore(const async_semaphore&) = delete;
+  async_semaphore& operator=(const async_semaphore&) = delete;
+
+  bool try_acquire()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (permits_ == 0)
+      return false;
+    --permits_;
+    return true;
+  }
+
+  resumable void acquire()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (permits_ > 0)
+    {
+      --permits_;
+      return;
+    }
+
+    waiter* this_waiter = waiter::active();
+    assert(this_waiter != nullptr);
+
+    detail::wait_node n;
+    n.waiter_ = this_waiter->shared_from_this();
+    waiters_.push(&n);
+    lock.unlock();
+    this_waiter->suspend("async_semaphore");
+  }
+
+  void release(std::size_t count = 1)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    detail::wait_queue wake;
+    for (; count > 0; --count)
+    {
+      detail::wait_node* n = waiters_.pop();
+      if (!n)
+        break;
+      wake.push(n);
+    }
+    permits_ += count;
+    lock.unlock();
+    wake.resume_all();
+  }
+
+  std::size_t available() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return permits_;
+  }
+
+private:
+  mutable std::mutex mutex_;
+  detail::wait_queue waiters_;
+  std::size_t permits_;
+};
+
+} // namespace rexp
+
+#endif // RESUMABLE_EXPRESSIONS_ASYNC_SEMAPHORE_HPP
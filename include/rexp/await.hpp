@@ -31,7 +31,7 @@ resumable T await(future<T> f)
         w->resume();
       });
 
-  this_waiter->suspend();
+  this_waiter->suspend("future");
   return result.get();
 }
 
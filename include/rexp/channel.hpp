@@ -0,0 +1,270 @@
+//
+// channel.hpp
+// ~~~~~~~~~~~
+// Bounded channel for passing values between waiters.
+//
+// Copyright (c) 2015 Christopher M. Kohlhoff (chris at kohlhoff dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef RESUMABLE_EXPRESSIONS_CHANNEL_HPP
+#define RESUMABLE_EXPRESSIONS_CHANNEL_HPP
+
+#include <boost/optional.hpp>
+#include <cassert>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "rexp/detail/wait_queue.hpp"
+#include "rexp/waiter.hpp"
+
+namespace rexp {
+
+class channel_closed : public std::exception
+{
+public:
+  const char* what() const noexcept
+  {
+    return "channel closed";
+  }
+};
+
+// A channel holds up to capacity values in a ring buffer. Senders suspend
+// while the buffer is full and receivers suspend while it is empty. A
+// channel with zero capacity hands each value directly from a sender to a
+// receiver.
+template <class T>
+class channel
+{
+public:
+  explicit channel(std::size_t capacity)
+    : buffer_(capacity)
+  {
+  }
+
+  channel(const channel&) = delete;
+  channel& operator=(const channel&) = delete;
+
+  resumable void send(T value)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    detail::wait_queue wake;
+    if (!try_send_locked(value, wake))
+    {
+      node n;
+      n.value_.emplace(std::move(value));
+      wait(lock, senders_, n, "channel send");
+      if (n.value_)
+        throw channel_closed();
+      return;
+    }
+    lock.unlock();
+    wake.resume_all();
+  }
+
+  // Sends all values in the range, suspending as needed for buffer space.
+  template <class InputIterator>
+  resumable void send(InputIterator first, InputIterator last)
+  {
+    while (first != last)
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      detail::wait_queue wake;
+      for (; first != last; ++first)
+      {
+        T value(*first);
+        if (!try_send_locked(value, wake))
+        {
+          lock.unlock();
+          wake.resume_all();
+          send(std::move(value));
+          ++first;
+          break;
+        }
+      }
+      if (lock.owns_lock())
+      {
+        lock.unlock();
+        wake.resume_all();
+      }
+    }
+  }
+
+  bool try_send(T& value)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    detail::wait_queue wake;
+    if (!try_send_locked(value, wake))
+      return false;
+    lock.unlock();
+    wake.resume_all();
+    return true;
+  }
+
+  resumable T receive()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    detail::wait_queue wake;
+    boost::optional<T> value;
+    if (!try_receive_locked(value, wake))
+    {
+      if (closed_)
+        throw channel_closed();
+
+      node n;
+      wait(lock, receivers_, n, "channel receive");
+      if (!n.value_)
+        throw channel_closed();
+      return std::move(*n.value_);
+    }
+    lock.unlock();
+    wake.resume_all();
+    return std::move(*value);
+  }
+
+  // Receives at least one and at most max values, returning the number
+  // received. Throws channel_closed if the channel is closed and empty.
+  template <class OutputIterator>
+  resumable std::size_t receive(OutputIterator out, std::size_t max)
+  {
+    assert(max > 0);
+
+    *out++ = receive();
+    std::size_t count = 1;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    detail::wait_queue wake;
+    boost::optional<T> value;
+    while (count < max && try_receive_locked(value, wake))
+    {
+      *out++ = std::move(*value);
+      value = boost::none;
+      ++count;
+    }
+    lock.unlock();
+    wake.resume_all();
+    return count;
+  }
+
+  bool try_receive(T& value)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    detail::wait_queue wake;
+    boost::optional<T> v;
+    if (!try_receive_locked(v, wake))
+      return false;
+    lock.unlock();
+    wake.resume_all();
+    value = std::move(*v);
+    return true;
+  }
+
+  // Wakes all suspended senders and receivers with channel_closed. Values
+  // already in the buffer may still be received.
+  void close()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    closed_ = true;
+    detail::wait_queue wake;
+    senders_.splice_into(wake);
+    receivers_.splice_into(wake);
+    lock.unlock();
+    wake.resume_all();
+  }
+
+  bool is_closed() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return closed_;
+  }
+
+private:
+  // A suspended sender's node holds the value it is waiting to send. A
+  // suspended receiver's node is filled in by the sender that wakes it.
+  struct node : detail::wait_node
+  {
+    boost::optional<T> value_;
+  };
+
+  resumable void wait(std::unique_lock<std::mutex>& lock,
+      detail::wait_queue& queue, node& n, const char* awaiting)
+  {
+    waiter* this_waiter = waiter::active();
+    assert(this_waiter != nullptr);
+
+    n.waiter_ = this_waiter->shared_from_this();
+    queue.push(&n);
+    lock.unlock();
+    this_waiter->suspend(awaiting);
+  }
+
+  bool try_send_locked(T& value, detail::wait_queue& wake)
+  {
+    if (closed_)
+      throw channel_closed();
+
+    if (node* r = static_cast<node*>(receivers_.pop()))
+    {
+      r->value_.emplace(std::move(value));
+      wake.push(r);
+      return true;
+    }
+
+    if (count_ < buffer_.size())
+    {
+      buffer_[(head_ + count_) % buffer_.size()].emplace(std::move(value));
+      ++count_;
+      return true;
+    }
+
+    return false;
+  }
+
+  bool try_receive_locked(boost::optional<T>& value,
+      detail::wait_queue& wake)
+  {
+    if (count_ > 0)
+    {
+      value.emplace(std::move(*buffer_[head_]));
+      buffer_[head_] = boost::none;
+      head_ = (head_ + 1) % buffer_.size();
+      --count_;
+
+      // Refill the slot just freed from the longest-waiting sender.
+      if (node* s = static_cast<node*>(senders_.pop()))
+      {
+        buffer_[(head_ + count_) % buffer_.size()] = std::move(s->value_);
+        s->value_ = boost::none;
+        ++count_;
+        wake.push(s);
+      }
+      return true;
+    }
+
+    if (node* s = static_cast<node*>(senders_.pop()))
+    {
+      value = std::move(s->value_);
+      s->value_ = boost::none;
+      wake.push(s);
+      return true;
+    }
+
+    return false;
+  }
+
+  mutable std::mutex mutex_;
+  std::vector<boost::optional<T>> buffer_;
+  std::size_t head_ = 0;
+  std::size_t count_ = 0;
+  detail::wait_queue senders_;
+  detail::wait_queue receivers_;
+  bool closed_ = false;
+};
+
+} // namespace rexp
+
+#endif // RESUMABLE_EXPRESSIONS_CHANNEL_HPP
@@ -0,0 +1,89 @@
+//
+// detail/handler_memory.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~
+// Small cache of memory blocks for recycling asynchronous operation state.
+//
+// Copyright (c) 2015 Christopher M. Kohlhoff (chris at kohlhoff dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef RESUMABLE_EXPRESSIONS_DETAIL_HANDLER_MEMORY_HPP
+#define RESUMABLE_EXPRESSIONS_DETAIL_HANDLER_MEMORY_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+namespace rexp {
+namespace detail {
+
+// Keeps up to two freed blocks for reuse. A waiter rarely has more than one
+// or two operations outstanding at once, so after the first few operations
+// a steady-state loop allocates nothing. Blocks may be freed on a different
+// thread from the one that allocated them.
+class handler_memory
+{
+public:
+  handler_memory() {}
+
+  handler_memory(const handler_memory&) = delete;
+  handler_memory& operator=(const handler_memory&) = delete;
+
+  ~handler_memory()
+  {
+    for (auto& slot: slots_)
+      if (header* h = slot.load(std::memory_order_relaxed))
+        ::operator delete(h);
+  }
+
+  void* allocate(std::size_t size)
+  {
+    for (auto& slot: slots_)
+    {
+      if (header* h = slot.exchange(nullptr, std::memory_order_acquire))
+      {
+        if (h->capacity_ >= size)
+          return h + 1;
+        ::operator delete(h);
+      }
+    }
+
+    // Round up so that a recycled block can serve slightly larger requests.
+    std::size_t capacity = (size + granularity - 1) & ~(granularity - 1);
+    header* h = static_cast<header*>(
+        ::operator new(sizeof(header) + capacity));
+    h->capacity_ = capacity;
+    return h + 1;
+  }
+
+  void deallocate(void* p) noexcept
+  {
+    header* h = static_cast<header*>(p) - 1;
+    for (auto& slot: slots_)
+    {
+      header* expected = nullptr;
+      if (slot.compare_exchange_strong(expected, h,
+            std::memory_order_release, std::memory_order_relaxed))
+        return;
+    }
+    ::operator delete(h);
+  }
+
+private:
+  static const std::size_t granularity = 64;
+
+  union header
+  {
+    std::size_t capacity_;
+    std::max_align_t align_;
+  };
+
+  std::atomic<header*> slots_[2] = {};
+};
+
+} // namespace detail
+} // namespace rexp
+
+#endif // RESUMABLE_EXPRESSIONS_DETAIL_HANDLER_MEMORY_HPP
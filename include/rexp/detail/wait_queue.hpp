@@ -0,0 +1,92 @@
+//
+// detail/wait_queue.hpp
+// ~~~~~~~~~~~~~~~~~~~~~
+// Intrusive FIFO queue of suspended waiters.
+//
+// Copyright (c) 2015 Christopher M. Kohlhoff (chris at kohlhoff dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef RESUMABLE_EXPRESSIONS_DETAIL_WAIT_QUEUE_HPP
+#define RESUMABLE_EXPRESSIONS_DETAIL_WAIT_QUEUE_HPP
+
+#include <memory>
+#include "rexp/waiter.hpp"
+
+namespace rexp {
+namespace detail {
+
+// Nodes live on the stack of the suspended waiter, so waiting does not
+// allocate. A node must not be touched once its waiter has been resumed.
+struct wait_node
+{
+  wait_node* next_ = nullptr;
+  std::shared_ptr<waiter> waiter_;
+};
+
+class wait_queue
+{
+public:
+  bool empty() const noexcept
+  {
+    return head_ == nullptr;
+  }
+
+  void push(wait_node* n) noexcept
+  {
+    n->next_ = nullptr;
+    if (tail_)
+      tail_->next_ = n;
+    else
+      head_ = n;
+    tail_ = n;
+  }
+
+  wait_node* pop() noexcept
+  {
+    wait_node* n = head_;
+    if (n)
+    {
+      head_ = n->next_;
+      if (!head_)
+        tail_ = nullptr;
+      n->next_ = nullptr;
+    }
+    return n;
+  }
+
+  // Moves every node onto the end of another queue.
+  void splice_into(wait_queue& other) noexcept
+  {
+    if (!head_)
+      return;
+    if (other.tail_)
+      other.tail_->next_ = head_;
+    else
+      other.head_ = head_;
+    other.tail_ = tail_;
+    head_ = tail_ = nullptr;
+  }
+
+  // Resumes every waiter in the queue. Call without holding any lock that
+  // the resumed waiters might need.
+  void resume_all()
+  {
+    while (wait_node* n = pop())
+    {
+      std::shared_ptr<waiter> w(std::move(n->waiter_));
+      w->resume();
+    }
+  }
+
+private:
+  wait_node* head_ = nullptr;
+  wait_node* tail_ = nullptr;
+};
+
+} // namespace detail
+} // namespace rexp
+
+#endif // RESUMABLE_EXPRESSIONS_DETAIL_WAIT_QUEUE_HPP
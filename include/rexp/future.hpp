@@ -18,6 +18,7 @@
 #include <memory>
 #include <mutex>
 #include <stdexcept>
+#include "rexp/trace.hpp"
 
 namespace rexp {
 
@@ -197,6 +198,8 @@ public:
     if (!state_)
       throw future_error("no future shared state");
 
+    REXP_TRACE_EVENT(promise_set_value, state_.get());
+
     std::unique_ptr<R> value(new R(std::move(r)));
 
     std::unique_lock<std::mutex> lock(state_->mutex_);
@@ -404,6 +407,8 @@ public:
     if (!state_)
       throw future_error("no future shared state");
 
+    REXP_TRACE_EVENT(promise_set_value, state_.get());
+
     std::unique_lock<std::mutex> lock(state_->mutex_);
 
     if (state_->ready_)
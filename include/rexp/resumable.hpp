@@ -15,7 +15,9 @@
 #include <boost/coroutine/asymmetric_coroutine.hpp>
 #include <boost/optional.hpp>
 #include <cassert>
+#include <cstddef>
 #include <exception>
+#include <memory>
 
 namespace rexp {
 
@@ -29,6 +31,39 @@ namespace detail
     static __thread pull_coroutine* r;
     return r;
   }
+
+  // Adapts a standard allocator for use as a coroutine stack allocator. The
+  // coroutine's control block is placed on the stack, so it comes from the
+  // same allocation.
+  template <class Allocator>
+  class stack_allocator_adaptor
+  {
+  public:
+    explicit stack_allocator_adaptor(const Allocator& a)
+      : allocator_(a)
+    {
+    }
+
+    void allocate(::boost::coroutines::stack_context& ctx, std::size_t size)
+    {
+      char* base = traits::allocate(allocator_, size);
+      ctx.size = size;
+      ctx.sp = base + size;
+    }
+
+    void deallocate(::boost::coroutines::stack_context& ctx)
+    {
+      char* base = static_cast<char*>(ctx.sp) - ctx.size;
+      traits::deallocate(allocator_, base, ctx.size);
+    }
+
+  private:
+    typedef typename std::allocator_traits<Allocator>::template
+      rebind_alloc<char> allocator_type;
+    typedef std::allocator_traits<allocator_type> traits;
+
+    allocator_type allocator_;
+  };
 }
 
 template <class R>
@@ -39,22 +74,15 @@ public:
 
   template <class F>
   explicit resumable_object(F f)
-    : push_(
-        [this, f](auto& pull)
-        {
-          this->pull_ = &pull;
-          (*this->pull_)();
-          try
-          {
-            this->result_.reset(f());
-            this->ready_ = true;
-          }
-          catch (...)
-          {
-            this->exception_ = std::current_exception();
-            this->ready_ = true;
-          }
-        })
+    : push_(entry(std::move(f)))
+  {
+    push_();
+  }
+
+  template <class F, class Allocator>
+  resumable_object(std::allocator_arg_t, const Allocator& a, F f)
+    : push_(entry(std::move(f)), ::boost::coroutines::attributes(),
+        detail::stack_allocator_adaptor<Allocator>(a))
   {
     push_();
   }
@@ -91,6 +119,26 @@ public:
   }
 
 private:
+  template <class F>
+  auto entry(F f)
+  {
+    return [this, f](auto& pull)
+      {
+        this->pull_ = &pull;
+        (*this->pull_)();
+        try
+        {
+          this->result_.reset(f());
+          this->ready_ = true;
+        }
+        catch (...)
+        {
+          this->exception_ = std::current_exception();
+          this->ready_ = true;
+        }
+      };
+  }
+
   detail::push_coroutine push_;
   detail::pull_coroutine* pull_;
   bool ready_ = false;
@@ -106,22 +154,15 @@ public:
 
   template <class F>
   explicit resumable_object(F f)
-    : push_(
-        [this, f](auto& pull)
-        {
-          this->pull_ = &pull;
-          (*this->pull_)();
-          try
-          {
-            f();
-            this->ready_ = true;
-          }
-          catch (...)
-          {
-            this->exception_ = std::current_exception();
-            this->ready_ = true;
-          }
-        })
+    : push_(entry(std::move(f)))
+  {
+    push_();
+  }
+
+  template <class F, class Allocator>
+  resumable_object(std::allocator_arg_t, const Allocator& a, F f)
+    : push_(entry(std::move(f)), ::boost::coroutines::attributes(),
+        detail::stack_allocator_adaptor<Allocator>(a))
   {
     push_();
   }
@@ -157,6 +198,26 @@ public:
   }
 
 private:
+  template <class F>
+  auto entry(F f)
+  {
+    return [this, f](auto& pull)
+      {
+        this->pull_ = &pull;
+        (*this->pull_)();
+        try
+        {
+          f();
+          this->ready_ = true;
+        }
+        catch (...)
+        {
+          this->exception_ = std::current_exception();
+          this->ready_ = true;
+        }
+      };
+  }
+
   detail::push_coroutine push_;
   detail::pull_coroutine* pull_;
   bool ready_ = false;
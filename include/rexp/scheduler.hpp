@@ -0,0 +1,33 @@
+//
+// scheduler.hpp
+// ~~~~~~~~~~~~~
+// Interface for objects that run waiters when they become ready.
+//
+// Copyright (c) 2015 Christopher M. Kohlhoff (chris at kohlhoff dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef RESUMABLE_EXPRESSIONS_SCHEDULER_HPP
+#define RESUMABLE_EXPRESSIONS_SCHEDULER_HPP
+
+#include <memory>
+
+namespace rexp {
+
+class waiter;
+
+class scheduler
+{
+public:
+  virtual ~scheduler() {}
+
+  // Queue a ready waiter. The scheduler must eventually call the waiter's
+  // run() function on one of its threads.
+  virtual void schedule(std::shared_ptr<waiter> w) = 0;
+};
+
+} // namespace rexp
+
+#endif // RESUMABLE_EXPRESSIONS_SCHEDULER_HPP
@@ -0,0 +1,219 @@
+//
+// sharded_runtime.hpp
+// ~~~~~~~~~~~~~~~~~~~
+// Thread-per-core runtime where each waiter stays on its home shard.
+//
+// Copyright (c) 2015 Christopher M. Kohlhoff (chris at kohlhoff dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef RESUMABLE_EXPRESSIONS_SHARDED_RUNTIME_HPP
+#define RESUMABLE_EXPRESSIONS_SHARDED_RUNTIME_HPP
+
+#include <boost/asio/io_service.hpp>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "rexp/scheduler.hpp"
+#include "rexp/waiter.hpp"
+
+#if defined(__linux__)
+# include <pthread.h>
+# include <sched.h>
+#endif
+
+namespace rexp {
+
+class sharded_runtime
+{
+public:
+  class shard : public scheduler
+  {
+  public:
+    shard(const shard&) = delete;
+    shard& operator=(const shard&) = delete;
+
+    boost::asio::io_service& get_io_service() noexcept
+    {
+      return io_service_;
+    }
+
+    std::size_t index() const noexcept
+    {
+      return index_;
+    }
+
+    bool running_in_this_thread() const noexcept
+    {
+      return current() == this;
+    }
+
+    // Waiters resumed on their home shard are queued locally. Resumptions
+    // from any other thread are collected in an inbox, and the home shard is
+    // woken once per batch rather than once per waiter.
+    virtual void schedule(std::shared_ptr<waiter> w)
+    {
+      if (running_in_this_thread())
+      {
+        local_.push_back(std::move(w));
+        if (!local_drain_pending_)
+        {
+          local_drain_pending_ = true;
+          io_service_.post([this]{ drain_local(); });
+        }
+      }
+      else
+      {
+        std::lock_guard<std::mutex> lock(inbox_mutex_);
+        inbox_.push_back(std::move(w));
+        if (!inbox_drain_pending_)
+        {
+          inbox_drain_pending_ = true;
+          io_service_.post([this]{ drain_inbox(); });
+        }
+      }
+    }
+
+    static shard* current() noexcept
+    {
+      return current_shard();
+    }
+
+  private:
+    friend class sharded_runtime;
+
+    explicit shard(std::size_t index)
+      : index_(index),
+        work_(new boost::asio::io_service::work(io_service_))
+    {
+    }
+
+    static shard*& current_shard()
+    {
+      static __thread shard* s;
+      return s;
+    }
+
+    void run(bool pin)
+    {
+#if defined(__linux__)
+      if (pin)
+      {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(index_ % CPU_SETSIZE, &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+      }
+#else
+      (void)pin;
+#endif
+
+      current_shard() = this;
+      io_service_.run();
+      current_shard() = nullptr;
+    }
+
+    void drain_local()
+    {
+      batch_.swap(local_);
+      local_drain_pending_ = false;
+      run_batch();
+    }
+
+    void drain_inbox()
+    {
+      {
+        std::lock_guard<std::mutex> lock(inbox_mutex_);
+        batch_.swap(inbox_);
+        inbox_drain_pending_ = false;
+      }
+      run_batch();
+    }
+
+    void run_batch()
+    {
+      std::vector<std::shared_ptr<waiter>> batch;
+      batch.swap(batch_);
+      for (auto& w: batch)
+        w->run();
+      batch.clear();
+      if (batch_.capacity() < batch.capacity())
+        batch_.swap(batch);
+    }
+
+    std::size_t index_;
+    boost::asio::io_service io_service_;
+    std::unique_ptr<boost::asio::io_service::work> work_;
+    std::thread thread_;
+
+    // Touched only by the shard's own thread.
+    std::vector<std::shared_ptr<waiter>> local_;
+    std::vector<std::shared_ptr<waiter>> batch_;
+    bool local_drain_pending_ = false;
+
+    std::mutex inbox_mutex_;
+    std::vector<std::shared_ptr<waiter>> inbox_;
+    bool inbox_drain_pending_ = false;
+  };
+
+  explicit sharded_runtime(
+      std::size_t shards = std::thread::hardware_concurrency(),
+      bool pin_threads = true)
+  {
+    if (shards == 0)
+      shards = 1;
+
+    for (std::size_t i = 0; i < shards; ++i)
+      shards_.emplace_back(new shard(i));
+
+    for (auto& s: shards_)
+    {
+      shard* p = s.get();
+      p->thread_ = std::thread([p, pin_threads]{ p->run(pin_threads); });
+    }
+  }
+
+  sharded_runtime(const sharded_runtime&) = delete;
+  sharded_runtime& operator=(const sharded_runtime&) = delete;
+
+  ~sharded_runtime()
+  {
+    stop();
+    join();
+  }
+
+  shard& at(std::size_t i)
+  {
+    return *shards_.at(i);
+  }
+
+  std::size_t size() const noexcept
+  {
+    return shards_.size();
+  }
+
+  // Let each shard's event loop exit once it has no more work.
+  void stop()
+  {
+    for (auto& s: shards_)
+      s->io_service_.post([p = s.get()]{ p->work_.reset(); });
+  }
+
+  void join()
+  {
+    for (auto& s: shards_)
+      if (s->thread_.joinable())
+        s->thread_.join();
+  }
+
+private:
+  std::vector<std::unique_ptr<shard>> shards_;
+};
+
+} // namespace rexp
+
+#endif // RESUMABLE_EXPRESSIONS_SHARDED_RUNTIME_HPP
@@ -12,69 +12,169 @@
 #ifndef RESUMABLE_EXPRESSIONS_SPAWN_HPP
 #define RESUMABLE_EXPRESSIONS_SPAWN_HPP
 
+#include <atomic>
+#include <exception>
+#include <memory>
 #include <type_traits>
 #include "rexp/future.hpp"
+#include "rexp/scheduler.hpp"
 #include "rexp/waiter.hpp"
 
 namespace rexp {
 
+typedef void (*unhandled_exception_handler)(std::exception_ptr);
+
+namespace detail
+{
+  inline std::atomic<unhandled_exception_handler>& unhandled_handler()
+  {
+    static std::atomic<unhandled_exception_handler> h{nullptr};
+    return h;
+  }
+
+  template <class Resumable>
+  struct detached_function
+  {
+    Resumable r_;
+
+    void operator()()
+    {
+      try
+      {
+        r_();
+      }
+      catch (...)
+      {
+        if (unhandled_exception_handler h = unhandled_handler().load())
+          h(std::current_exception());
+      }
+    }
+  };
+
+  template <class Resumable,
+      class R = typename std::result_of<Resumable()>::type>
+  struct spawned_function
+  {
+    Resumable r_;
+    promise<R> p_;
+
+    void operator()()
+    {
+      try
+      {
+        p_.set_value(r_());
+      }
+      catch (...)
+      {
+        p_.set_exception(std::current_exception());
+      }
+    }
+  };
+
+  template <class Resumable>
+  struct spawned_function<Resumable, void>
+  {
+    Resumable r_;
+    promise<void> p_;
+
+    void operator()()
+    {
+      try
+      {
+        r_();
+        p_.set_value();
+      }
+      catch (...)
+      {
+        p_.set_exception(std::current_exception());
+      }
+    }
+  };
+} // namespace detail
+
 template <class Resumable>
-auto spawn(Resumable r,
-    typename std::enable_if<
-      !std::is_same<
-        typename std::result_of<Resumable()>::type,
-        void
-      >::value
-    >::type* = 0)
+auto spawn(Resumable r)
 {
   promise<typename std::result_of<Resumable()>::type> p;
   auto f = p.get_future();
 
   launch_waiter(
-      [r = std::move(r), p = std::move(p)]() mutable
-      {
-        try
-        {
-          p.set_value(r());
-        }
-        catch (...)
-        {
-          p.set_exception(std::current_exception());
-        }
-      });
+      detail::spawned_function<Resumable>{std::move(r), std::move(p)});
 
   return f;
 }
 
 template <class Resumable>
-auto spawn(Resumable r,
-    typename std::enable_if<
-      std::is_same<
-        typename std::result_of<Resumable()>::type,
-        void
-      >::value
-    >::type* = 0)
+auto spawn(scheduler& s, Resumable r)
 {
   promise<typename std::result_of<Resumable()>::type> p;
   auto f = p.get_future();
 
-  launch_waiter(
-      [r = std::move(r), p = std::move(p)]() mutable
-      {
-        try
-        {
-          r();
-          p.set_value();
-        }
-        catch (...)
-        {
-          p.set_exception(std::current_exception());
-        }
-      });
+  launch_waiter(s,
+      detail::spawned_function<Resumable>{std::move(r), std::move(p)});
+
+  return f;
+}
+
+template <class Allocator, class Resumable>
+auto spawn(std::allocator_arg_t, const Allocator& a, Resumable r)
+{
+  promise<typename std::result_of<Resumable()>::type> p(std::allocator_arg, a);
+  auto f = p.get_future();
+
+  launch_waiter(std::allocator_arg, a,
+      detail::spawned_function<Resumable>{std::move(r), std::move(p)});
 
   return f;
 }
 
+template <class Allocator, class Resumable>
+auto spawn(scheduler& s, std::allocator_arg_t, const Allocator& a, Resumable r)
+{
+  promise<typename std::result_of<Resumable()>::type> p(std::allocator_arg, a);
+  auto f = p.get_future();
+
+  launch_waiter(s, std::allocator_arg, a,
+      detail::spawned_function<Resumable>{std::move(r), std::move(p)});
+
+  return f;
+}
+
+// Sets the function called with exceptions that escape a detached waiter.
+// By default such exceptions are discarded.
+inline unhandled_exception_handler set_unhandled_exception_handler(
+    unhandled_exception_handler h) noexcept
+{
+  return detail::unhandled_handler().exchange(h);
+}
+
+template <class Resumable>
+void spawn_detached(Resumable r)
+{
+  launch_waiter(detail::detached_function<Resumable>{std::move(r)});
+}
+
+template <class Resumable>
+void spawn_detached(scheduler& s, Resumable r)
+{
+  launch_waiter(s, detail::detached_function<Resumable>{std::move(r)});
+}
+
+template <class Allocator, class Resumable>
+void spawn_detached(std::allocator_arg_t, const Allocator& a, Resumable r)
+{
+  launch_waiter(std::allocator_arg, a,
+      detail::detached_function<Resumable>{std::move(r)});
+}
+
+template <class Allocator, class Resumable>
+void spawn_detached(scheduler& s,
+    std::allocator_arg_t, const Allocator& a, Resumable r)
+{
+  launch_waiter(s, std::allocator_arg, a,
+      detail::detached_function<Resumable>{std::move(r)});
+}
+
 } // namespace rexp
 
 #endif // RESUMABLE_EXPRESSIONS_SPAWN_HPP
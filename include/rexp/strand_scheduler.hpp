@@ -0,0 +1,94 @@
+//
+// strand_scheduler.hpp
+// ~~~~~~~~~~~~~~~~~~~~
+// Scheduler that runs a waiter through an asio strand.
+//
+// Copyright (c) 2015 Christopher M. Kohlhoff (chris at kohlhoff dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef RESUMABLE_EXPRESSIONS_STRAND_SCHEDULER_HPP
+#define RESUMABLE_EXPRESSIONS_STRAND_SCHEDULER_HPP
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/strand.hpp>
+#include <cstddef>
+#include <memory>
+#include "rexp/scheduler.hpp"
+#include "rexp/waiter.hpp"
+
+namespace rexp {
+
+namespace detail
+{
+  struct strand_run_handler
+  {
+    void operator()()
+    {
+      waiter_->run();
+    }
+
+    std::shared_ptr<waiter> waiter_;
+  };
+
+  inline void* asio_handler_allocate(std::size_t size, strand_run_handler* h)
+  {
+    return h->waiter_->handler_memory().allocate(size);
+  }
+
+  inline void asio_handler_deallocate(void* p, std::size_t,
+      strand_run_handler* h)
+  {
+    h->waiter_->handler_memory().deallocate(p);
+  }
+} // namespace detail
+
+// Waiters bound to a strand_scheduler only ever run inside its strand, so
+// an io_service may be run on many threads while the completions of each
+// waiter's operations are still processed one at a time. Give each
+// independent waiter, such as a connection, its own strand_scheduler.
+//
+// The scheduler must outlive the waiters bound to it. A waiter may keep its
+// scheduler alive by capturing a shared_ptr to it.
+class strand_scheduler : public scheduler
+{
+public:
+  explicit strand_scheduler(boost::asio::io_service& io_service)
+    : strand_(io_service)
+  {
+  }
+
+  strand_scheduler(const strand_scheduler&) = delete;
+  strand_scheduler& operator=(const strand_scheduler&) = delete;
+
+  boost::asio::io_service::strand& get_strand() noexcept
+  {
+    return strand_;
+  }
+
+  bool running_in_this_thread() const noexcept
+  {
+    return strand_.running_in_this_thread();
+  }
+
+  // A waiter resumed from a completion handler already inside the strand is
+  // run immediately. A waiter resumed by another running waiter is posted
+  // instead, so that long chains of resumptions do not nest.
+  virtual void schedule(std::shared_ptr<waiter> w)
+  {
+    detail::strand_run_handler handler{std::move(w)};
+    if (waiter::active())
+      strand_.post(std::move(handler));
+    else
+      strand_.dispatch(std::move(handler));
+  }
+
+private:
+  boost::asio::io_service::strand strand_;
+};
+
+} // namespace rexp
+
+#endif // RESUMABLE_EXPRESSIONS_STRAND_SCHEDULER_HPP
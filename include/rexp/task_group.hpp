@@ -0,0 +1,148 @@
+//
+// task_group.hpp
+// ~~~~~~~~~~~~~~
+// Spawn a group of resumable functions and await them together.
+//
+// Copyright (c) 2015 Christopher M. Kohlhoff (chris at kohlhoff dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef RESUMABLE_EXPRESSIONS_TASK_GROUP_HPP
+#define RESUMABLE_EXPRESSIONS_TASK_GROUP_HPP
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include "rexp/scheduler.hpp"
+#include "rexp/waiter.hpp"
+
+namespace rexp {
+
+namespace detail
+{
+  // All children of a group share this state. Completion is tracked by a
+  // single counter, which also holds one reference on behalf of join().
+  struct task_group_state
+  {
+    std::atomic<std::size_t> outstanding_{1};
+    std::atomic<bool> cancelled_{false};
+    std::atomic<bool> failed_{false};
+    std::exception_ptr exception_;
+    std::shared_ptr<waiter> joiner_;
+
+    void complete()
+    {
+      if (--outstanding_ == 0)
+      {
+        std::shared_ptr<waiter> w(std::move(joiner_));
+        w->resume();
+      }
+    }
+
+    void fail(std::exception_ptr e)
+    {
+      if (!failed_.exchange(true))
+        exception_ = std::move(e);
+      cancelled_ = true;
+    }
+  };
+
+  template <class Resumable>
+  struct task_group_child
+  {
+    Resumable r_;
+    std::shared_ptr<task_group_state> state_;
+
+    void operator()()
+    {
+      try
+      {
+        r_();
+      }
+      catch (...)
+      {
+        state_->fail(std::current_exception());
+      }
+      state_->complete();
+    }
+  };
+} // namespace detail
+
+class task_group
+{
+public:
+  task_group()
+    : state_(std::make_shared<detail::task_group_state>())
+  {
+  }
+
+  explicit task_group(scheduler& s)
+    : state_(std::make_shared<detail::task_group_state>()),
+      scheduler_(&s)
+  {
+  }
+
+  task_group(const task_group&) = delete;
+  task_group& operator=(const task_group&) = delete;
+
+  // Children are not started once the group has been cancelled.
+  template <class Resumable>
+  void spawn(Resumable r)
+  {
+    if (cancelled())
+      return;
+
+    ++state_->outstanding_;
+    detail::task_group_child<Resumable> child{std::move(r), state_};
+    if (scheduler_)
+      launch_waiter(*scheduler_, std::move(child));
+    else
+      launch_waiter(std::move(child));
+  }
+
+  // Suspends the calling waiter until every child has completed, then
+  // rethrows the first exception thrown by a child, if any.
+  resumable void join()
+  {
+    waiter* this_waiter = waiter::active();
+    assert(this_waiter != nullptr);
+
+    state_->joiner_ = this_waiter->shared_from_this();
+    if (--state_->outstanding_ == 0)
+      state_->joiner_.reset();
+    else
+      this_waiter->suspend("task_group");
+
+    state_->outstanding_ = 1;
+    state_->cancelled_ = false;
+    if (state_->failed_.exchange(false))
+    {
+      std::exception_ptr e(std::move(state_->exception_));
+      std::rethrow_exception(e);
+    }
+  }
+
+  // Cancellation is cooperative. Running children should poll cancelled()
+  // and return early when it is set.
+  void cancel() noexcept
+  {
+    state_->cancelled_ = true;
+  }
+
+  bool cancelled() const noexcept
+  {
+    return state_->cancelled_;
+  }
+
+private:
+  std::shared_ptr<detail::task_group_state> state_;
+  scheduler* scheduler_ = nullptr;
+};
+
+} // namespace rexp
+
+#endif // RESUMABLE_EXPRESSIONS_TASK_GROUP_HPP
@@ -0,0 +1,181 @@
+//
+// thread_pool.hpp
+// ~~~~~~~~~~~~~~~
+// Work-stealing pool of threads for running waiters.
+//
+// Copyright (c) 2015 Christopher M. Kohlhoff (chris at kohlhoff dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef RESUMABLE_EXPRESSIONS_THREAD_POOL_HPP
+#define RESUMABLE_EXPRESSIONS_THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "rexp/scheduler.hpp"
+#include "rexp/waiter.hpp"
+
+namespace rexp {
+
+class thread_pool : public scheduler
+{
+public:
+  explicit thread_pool(
+      std::size_t threads = std::thread::hardware_concurrency())
+  {
+    if (threads == 0)
+      threads = 1;
+
+    for (std::size_t i = 0; i < threads; ++i)
+      workers_.emplace_back(new worker(this));
+
+    for (std::size_t i = 0; i < threads; ++i)
+      workers_[i]->thread_ = std::thread([this, i]{ run_worker(i); });
+  }
+
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+
+  ~thread_pool()
+  {
+    stop();
+    join();
+  }
+
+  virtual void schedule(std::shared_ptr<waiter> w)
+  {
+    worker* target = current_worker();
+    if (!target || target->owner_ != this)
+      target = workers_[next_worker_++ % workers_.size()].get();
+
+    ++pending_;
+    {
+      std::lock_guard<std::mutex> lock(target->mutex_);
+      target->queue_.push_back(std::move(w));
+    }
+
+    if (idle_ > 0)
+    {
+      std::lock_guard<std::mutex> lock(idle_mutex_);
+      idle_condition_.notify_one();
+    }
+  }
+
+  // Ask the worker threads to exit once all queued waiters have run.
+  void stop()
+  {
+    std::lock_guard<std::mutex> lock(idle_mutex_);
+    stopped_ = true;
+    idle_condition_.notify_all();
+  }
+
+  void join()
+  {
+    for (auto& w : workers_)
+      if (w->thread_.joinable())
+        w->thread_.join();
+  }
+
+  std::size_t size() const noexcept
+  {
+    return workers_.size();
+  }
+
+private:
+  struct worker
+  {
+    explicit worker(thread_pool* owner) : owner_(owner) {}
+
+    thread_pool* owner_;
+    std::mutex mutex_;
+    std::deque<std::shared_ptr<waiter>> queue_;
+    std::thread thread_;
+  };
+
+  static worker*& current_worker()
+  {
+    static __thread worker* w;
+    return w;
+  }
+
+  // The owning thread takes waiters from the front of its own queue, so that
+  // they run in the order in which they became ready.
+  static bool pop(worker& w, std::shared_ptr<waiter>& result)
+  {
+    std::lock_guard<std::mutex> lock(w.mutex_);
+    if (w.queue_.empty())
+      return false;
+    result = std::move(w.queue_.front());
+    w.queue_.pop_front();
+    return true;
+  }
+
+  // Thieves take from the back, away from where the owner is working.
+  bool steal(std::size_t thief, std::shared_ptr<waiter>& result)
+  {
+    for (std::size_t i = 1; i < workers_.size(); ++i)
+    {
+      worker& victim = *workers_[(thief + i) % workers_.size()];
+      std::unique_lock<std::mutex> lock(victim.mutex_, std::try_to_lock);
+      if (lock.owns_lock() && !victim.queue_.empty())
+      {
+        result = std::move(victim.queue_.back());
+        victim.queue_.pop_back();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void run_worker(std::size_t index)
+  {
+    worker& self = *workers_[index];
+    current_worker() = &self;
+
+    for (;;)
+    {
+      std::shared_ptr<waiter> w;
+      if (pop(self, w) || steal(index, w))
+      {
+        --pending_;
+        w->run();
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(idle_mutex_);
+      ++idle_;
+      if (pending_ == 0)
+      {
+        if (stopped_)
+        {
+          --idle_;
+          break;
+        }
+        idle_condition_.wait(lock);
+      }
+      --idle_;
+    }
+
+    current_worker() = nullptr;
+  }
+
+  std::vector<std::unique_ptr<worker>> workers_;
+  std::atomic<std::size_t> next_worker_{0};
+  std::atomic<std::size_t> pending_{0};
+  std::atomic<std::size_t> idle_{0};
+  std::mutex idle_mutex_;
+  std::condition_variable idle_condition_;
+  bool stopped_ = false;
+};
+
+} // namespace rexp
+
+#endif // RESUMABLE_EXPRESSIONS_THREAD_POOL_HPP
@@ -0,0 +1,310 @@
+//
+// timer_service.hpp
+// ~~~~~~~~~~~~~~~~~
+// Timing wheel driven by a single service thread, with awaitable sleeps.
+//
+// Copyright (c) 2015 Christopher M. Kohlhoff (chris at kohlhoff dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef RESUMABLE_EXPRESSIONS_TIMER_SERVICE_HPP
+#define RESUMABLE_EXPRESSIONS_TIMER_SERVICE_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "rexp/future.hpp"
+
+namespace rexp {
+
+class timer_cancelled : public std::exception
+{
+public:
+  const char* what() const noexcept
+  {
+    return "timer cancelled";
+  }
+};
+
+class timer;
+
+namespace detail
+{
+  struct timer_node
+  {
+    timer_node* prev_ = nullptr;
+    timer_node* next_ = nullptr;
+    std::uint64_t deadline_ = 0;
+    bool linked_ = false;
+    bool owned_by_service_ = false;
+    promise<void> promise_;
+  };
+}
+
+// Timers are kept in a hashed timing wheel. Each slot holds an intrusive list
+// of the timers whose deadline tick maps to it, so adding and cancelling a
+// timer are constant time, and each tick only examines a single slot.
+class timer_service
+{
+public:
+  typedef std::chrono::steady_clock clock_type;
+
+  explicit timer_service(
+      clock_type::duration resolution = std::chrono::milliseconds(1),
+      std::size_t slots = 4096)
+    : resolution_(resolution),
+      start_(clock_type::now()),
+      wheel_(slots)
+  {
+    thread_ = std::thread([this]{ run(); });
+  }
+
+  timer_service(const timer_service&) = delete;
+  timer_service& operator=(const timer_service&) = delete;
+
+  ~timer_service()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopped_ = true;
+      condition_.notify_one();
+    }
+    thread_.join();
+
+    for (auto& slot: wheel_)
+    {
+      while (detail::timer_node* n = slot)
+      {
+        slot = n->next_;
+        n->linked_ = false;
+        if (n->owned_by_service_)
+          delete n;
+      }
+    }
+  }
+
+  future<void> sleep_until(clock_type::time_point t)
+  {
+    detail::timer_node* n = new detail::timer_node;
+    n->owned_by_service_ = true;
+    future<void> f = n->promise_.get_future();
+    add(n, t);
+    return f;
+  }
+
+  future<void> sleep_for(clock_type::duration d)
+  {
+    return sleep_until(clock_type::now() + d);
+  }
+
+  static timer_service& instance()
+  {
+    static timer_service s;
+    return s;
+  }
+
+private:
+  friend class timer;
+
+  std::uint64_t to_tick(clock_type::time_point t) const
+  {
+    if (t <= start_)
+      return 0;
+    return (t - start_ + resolution_ - clock_type::duration(1)) / resolution_;
+  }
+
+  // Takes ownership of the node's promise if the deadline has already passed.
+  void add(detail::timer_node* n, clock_type::time_point t)
+  {
+    std::uint64_t deadline = to_tick(t);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (deadline <= current_tick_)
+    {
+      promise<void> p(std::move(n->promise_));
+      if (n->owned_by_service_)
+        delete n;
+      lock.unlock();
+      p.set_value();
+      return;
+    }
+
+    n->deadline_ = deadline;
+    detail::timer_node*& slot = wheel_[deadline % wheel_.size()];
+    n->prev_ = nullptr;
+    n->next_ = slot;
+    if (slot)
+      slot->prev_ = n;
+    slot = n;
+    n->linked_ = true;
+
+    if (pending_++ == 0)
+      condition_.notify_one();
+  }
+
+  // Returns true and takes the node's promise if the timer had not yet fired.
+  bool remove(detail::timer_node* n, promise<void>& p)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!n->linked_)
+      return false;
+
+    unlink(n);
+    p = std::move(n->promise_);
+    return true;
+  }
+
+  void unlink(detail::timer_node* n)
+  {
+    if (n->prev_)
+      n->prev_->next_ = n->next_;
+    else
+      wheel_[n->deadline_ % wheel_.size()] = n->next_;
+    if (n->next_)
+      n->next_->prev_ = n->prev_;
+    n->prev_ = n->next_ = nullptr;
+    n->linked_ = false;
+    --pending_;
+  }
+
+  void expire_slot(std::size_t index, std::uint64_t now)
+  {
+    detail::timer_node* n = wheel_[index];
+    while (n)
+    {
+      detail::timer_node* next = n->next_;
+      if (n->deadline_ <= now)
+      {
+        unlink(n);
+        expired_.push_back(std::move(n->promise_));
+        if (n->owned_by_service_)
+          delete n;
+      }
+      n = next;
+    }
+  }
+
+  void run()
+  {
+    std::vector<promise<void>> ready;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopped_)
+    {
+      if (pending_ == 0)
+      {
+        current_tick_ = to_tick(clock_type::now());
+        condition_.wait(lock);
+        continue;
+      }
+
+      std::uint64_t now = to_tick(clock_type::now());
+      if (now > current_tick_)
+      {
+        // After a long stall every slot is visited once, rather than once
+        // for each elapsed tick.
+        std::uint64_t ticks = now - current_tick_;
+        if (ticks > wheel_.size())
+          ticks = wheel_.size();
+        for (std::uint64_t i = 1; i <= ticks; ++i)
+          expire_slot((current_tick_ + i) % wheel_.size(), now);
+        current_tick_ = now;
+      }
+
+      if (!expired_.empty())
+      {
+        ready.swap(expired_);
+        lock.unlock();
+        for (auto& p: ready)
+          p.set_value();
+        ready.clear();
+        lock.lock();
+        continue;
+      }
+
+      condition_.wait_until(lock, start_ + resolution_ * (current_tick_ + 1));
+    }
+  }
+
+  const clock_type::duration resolution_;
+  const clock_type::time_point start_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::vector<detail::timer_node*> wheel_;
+  std::vector<promise<void>> expired_;
+  std::uint64_t current_tick_ = 0;
+  std::size_t pending_ = 0;
+  bool stopped_ = false;
+  std::thread thread_;
+};
+
+// A reusable timer that can be cancelled. Waiting on a timer does not
+// allocate beyond the future's shared state.
+class timer
+{
+public:
+  typedef timer_service::clock_type clock_type;
+
+  explicit timer(timer_service& s = timer_service::instance())
+    : service_(s)
+  {
+  }
+
+  timer(const timer&) = delete;
+  timer& operator=(const timer&) = delete;
+
+  ~timer()
+  {
+    cancel();
+  }
+
+  future<void> wait_until(clock_type::time_point t)
+  {
+    cancel();
+    node_.promise_ = promise<void>();
+    future<void> f = node_.promise_.get_future();
+    service_.add(&node_, t);
+    return f;
+  }
+
+  future<void> wait_for(clock_type::duration d)
+  {
+    return wait_until(clock_type::now() + d);
+  }
+
+  // Completes an outstanding wait with timer_cancelled. Returns false if
+  // there was no wait outstanding.
+  bool cancel()
+  {
+    promise<void> p;
+    if (!service_.remove(&node_, p))
+      return false;
+    p.set_exception(std::make_exception_ptr(timer_cancelled()));
+    return true;
+  }
+
+private:
+  timer_service& service_;
+  detail::timer_node node_;
+};
+
+inline future<void> sleep_until(timer_service::clock_type::time_point t)
+{
+  return timer_service::instance().sleep_until(t);
+}
+
+inline future<void> sleep_for(timer_service::clock_type::duration d)
+{
+  return timer_service::instance().sleep_for(d);
+}
+
+} // namespace rexp
+
+#endif // RESUMABLE_EXPRESSIONS_TIMER_SERVICE_HPP
@@ -0,0 +1,186 @@
+//
+// trace.hpp
+// ~~~~~~~~~
+// Opt-in tracing of waiter lifecycle events in Chrome trace_event format.
+//
+// Copyright (c) 2015 Christopher M. Kohlhoff (chris at kohlhoff dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef RESUMABLE_EXPRESSIONS_TRACE_HPP
+#define RESUMABLE_EXPRESSIONS_TRACE_HPP
+
+// Tracing is compiled in only when REXP_ENABLE_TRACING is defined. Otherwise
+// the hooks expand to nothing.
+#if defined(REXP_ENABLE_TRACING)
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+# include <x86intrin.h>
+#endif
+
+namespace rexp {
+namespace trace {
+
+enum event_type
+{
+  waiter_launch,
+  waiter_run_begin,
+  waiter_run_end,
+  waiter_suspend,
+  waiter_resume,
+  promise_set_value
+};
+
+namespace detail
+{
+  inline std::uint64_t timestamp() noexcept
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+  }
+
+  struct event
+  {
+    std::uint64_t timestamp_;
+    const void* id_;
+    event_type type_;
+  };
+
+  // Each thread writes only to its own buffer. When the buffer is full the
+  // oldest events are overwritten.
+  struct thread_buffer
+  {
+    static const std::size_t size = 1 << 16;
+
+    explicit thread_buffer(std::size_t thread_id)
+      : thread_id_(thread_id)
+    {
+    }
+
+    void record(event_type type, const void* id) noexcept
+    {
+      std::size_t n = next_.load(std::memory_order_relaxed);
+      event& e = events_[n % size];
+      e.timestamp_ = timestamp();
+      e.id_ = id;
+      e.type_ = type;
+      next_.store(n + 1, std::memory_order_release);
+    }
+
+    std::size_t thread_id_;
+    std::atomic<std::size_t> next_{0};
+    event events_[size];
+  };
+
+  struct registry
+  {
+    std::mutex mutex_;
+    std::vector<thread_buffer*> buffers_;
+    std::uint64_t start_timestamp_ = timestamp();
+    std::chrono::steady_clock::time_point start_time_ =
+      std::chrono::steady_clock::now();
+
+    static registry& instance()
+    {
+      static registry r;
+      return r;
+    }
+  };
+
+  // Buffers are registered on a thread's first event and are never freed,
+  // so that events from threads that have exited can still be dumped.
+  inline thread_buffer& this_thread_buffer()
+  {
+    static __thread thread_buffer* b;
+    if (!b)
+    {
+      registry& r = registry::instance();
+      std::lock_guard<std::mutex> lock(r.mutex_);
+      b = new thread_buffer(r.buffers_.size() + 1);
+      r.buffers_.push_back(b);
+    }
+    return *b;
+  }
+} // namespace detail
+
+inline void record(event_type type, const void* id) noexcept
+{
+  detail::this_thread_buffer().record(type, id);
+}
+
+// Writes the events recorded so far to a file that can be loaded by
+// chrome://tracing. Returns false if the file could not be written.
+inline bool dump(const char* path)
+{
+  static const char* const names[] =
+  {
+    "launch", "run", "run", "suspend", "resume", "set_value"
+  };
+
+  detail::registry& r = detail::registry::instance();
+  std::lock_guard<std::mutex> lock(r.mutex_);
+
+  double ticks_per_us = 1000.0;
+#if defined(__x86_64__) || defined(__i386__)
+  std::uint64_t elapsed_ticks = detail::timestamp() - r.start_timestamp_;
+  double elapsed_us = std::chrono::duration<double, std::micro>(
+      std::chrono::steady_clock::now() - r.start_time_).count();
+  if (elapsed_us > 0)
+    ticks_per_us = elapsed_ticks / elapsed_us;
+#endif
+
+  std::FILE* f = std::fopen(path, "w");
+  if (!f)
+    return false;
+
+  std::fprintf(f, "{\"traceEvents\":[\n");
+  const char* separator = "";
+  for (detail::thread_buffer* b: r.buffers_)
+  {
+    std::size_t end = b->next_.load(std::memory_order_acquire);
+    std::size_t begin = end > b->size ? end - b->size : 0;
+    for (std::size_t i = begin; i < end; ++i)
+    {
+      const detail::event& e = b->events_[i % b->size];
+      const char* phase = e.type_ == waiter_run_begin ? "B"
+        : e.type_ == waiter_run_end ? "E" : "i";
+      double ts = (e.timestamp_ - r.start_timestamp_) / ticks_per_us;
+      std::fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,"
+          "\"pid\":1,\"tid\":%zu,%s\"args\":{\"id\":\"%p\"}}",
+          separator, names[e.type_], phase, ts, b->thread_id_,
+          *phase == 'i' ? "\"s\":\"t\"," : "", e.id_);
+      separator = ",\n";
+    }
+  }
+  std::fprintf(f, "\n]}\n");
+
+  return std::fclose(f) == 0;
+}
+
+} // namespace trace
+} // namespace rexp
+
+# define REXP_TRACE_EVENT(type, id) \
+  ::rexp::trace::record(::rexp::trace::type, id)
+
+#else // defined(REXP_ENABLE_TRACING)
+
+# define REXP_TRACE_EVENT(type, id) ((void)0)
+
+#endif // defined(REXP_ENABLE_TRACING)
+
+#endif // RESUMABLE_EXPRESSIONS_TRACE_HPP
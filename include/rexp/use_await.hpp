@@ -14,8 +14,15 @@
 
 #include <boost/optional.hpp>
 #include <boost/asio/async_result.hpp>
+#include <boost/asio/error.hpp>
 #include <boost/asio/handler_type.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/system/system_error.hpp>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cstddef>
 #include <memory>
 #include <tuple>
 #include <type_traits>
@@ -23,11 +30,56 @@
 
 namespace rexp {
 
+template <class IoObject> struct use_await_timeout_t;
+
 constexpr struct use_await_t
 {
   constexpr use_await_t() {}
+
+  constexpr explicit use_await_t(boost::system::error_code* ec)
+    : ec_(ec)
+  {
+  }
+
+  // Returns a token that stores errors in ec rather than throwing them.
+  constexpr use_await_t operator[](boost::system::error_code& ec) const
+  {
+    return use_await_t(&ec);
+  }
+
+  // Returns a token that cancels the operation on the given I/O object if it
+  // has not completed within the timeout. The operation then fails with
+  // boost::asio::error::timed_out.
+  template <class IoObject>
+  use_await_timeout_t<IoObject> with_timeout(IoObject& object,
+      std::chrono::steady_clock::duration timeout) const
+  {
+    return use_await_timeout_t<IoObject>(&object, timeout, ec_);
+  }
+
+  boost::system::error_code* ec_ = nullptr;
 } use_await;
 
+template <class IoObject>
+struct use_await_timeout_t
+{
+  use_await_timeout_t(IoObject* object,
+      std::chrono::steady_clock::duration timeout,
+      boost::system::error_code* ec)
+    : object_(object), timeout_(timeout), ec_(ec)
+  {
+  }
+
+  use_await_timeout_t operator[](boost::system::error_code& ec) const
+  {
+    return use_await_timeout_t(object_, timeout_, &ec);
+  }
+
+  IoObject* object_;
+  std::chrono::steady_clock::duration timeout_;
+  boost::system::error_code* ec_;
+};
+
 namespace detail
 {
   using boost::system::error_code;
@@ -43,6 +95,22 @@ namespace detail
     std::exception_ptr* exception_ = nullptr;
   };
 
+  // Operation state is allocated from a cache belonging to the waiter, so
+  // that a steady stream of operations performs no heap allocation.
+  template <class... Args>
+  inline void* asio_handler_allocate(std::size_t size,
+      await_handler_base<Args...>* h)
+  {
+    return h->waiter_->handler_memory().allocate(size);
+  }
+
+  template <class... Args>
+  inline void asio_handler_deallocate(void* p, std::size_t,
+      await_handler_base<Args...>* h)
+  {
+    h->waiter_->handler_memory().deallocate(p);
+  }
+
   template <class... Args>
   struct await_handler : await_handler_base<Args...>
   {
@@ -58,16 +126,28 @@ namespace detail
   template <class... Args>
   struct await_handler<error_code, Args...> : await_handler_base<Args...>
   {
-    await_handler(use_await_t) {}
+    await_handler(use_await_t token) : ec_(token.ec_) {}
 
     void operator()(const error_code& ec, Args... args)
     {
-      if (ec)
+      store(ec, std::forward<Args>(args)...);
+      this->waiter_->resume();
+    }
+
+    void store(const error_code& ec, Args... args)
+    {
+      if (ec_)
+      {
+        *ec_ = ec;
+        this->result_->reset(std::make_tuple(std::forward<Args>(args)...));
+      }
+      else if (ec)
         *this->exception_ = std::make_exception_ptr(system_error(ec));
       else
         this->result_->reset(std::make_tuple(std::forward<Args>(args)...));
-      this->waiter_->resume();
     }
+
+    error_code* ec_;
   };
 
   template <class... Args>
@@ -85,6 +165,88 @@ namespace detail
     }
   };
 
+  // The operation and its deadline timer both hold a count. Whichever
+  // completes last resumes the waiter, so neither handler can outlive the
+  // awaiting frame that owns this state.
+  template <class IoObject>
+  struct await_timeout_state
+  {
+    explicit await_timeout_state(IoObject& object)
+      : object_(object),
+        timer_(object.get_io_service())
+    {
+    }
+
+    void complete(const std::shared_ptr<waiter>& w)
+    {
+      if (--outstanding_ == 0)
+        w->resume();
+    }
+
+    IoObject& object_;
+    boost::asio::steady_timer timer_;
+    std::atomic<int> outstanding_{2};
+    std::atomic<bool> timed_out_{false};
+  };
+
+  template <class IoObject>
+  struct await_deadline_handler
+  {
+    void operator()(const error_code& ec)
+    {
+      if (!ec)
+      {
+        state_->timed_out_ = true;
+        error_code ignored;
+        state_->object_.cancel(ignored);
+      }
+      state_->complete(waiter_);
+    }
+
+    std::shared_ptr<waiter> waiter_;
+    await_timeout_state<IoObject>* state_;
+  };
+
+  template <class IoObject>
+  inline void* asio_handler_allocate(std::size_t size,
+      await_deadline_handler<IoObject>* h)
+  {
+    return h->waiter_->handler_memory().allocate(size);
+  }
+
+  template <class IoObject>
+  inline void asio_handler_deallocate(void* p, std::size_t,
+      await_deadline_handler<IoObject>* h)
+  {
+    h->waiter_->handler_memory().deallocate(p);
+  }
+
+  template <class IoObject, class... Args>
+  struct await_timeout_handler : await_handler<error_code, Args...>
+  {
+    await_timeout_handler(use_await_timeout_t<IoObject> token)
+      : await_handler<error_code, Args...>(use_await_t(token.ec_)),
+        object_(token.object_),
+        timeout_(token.timeout_)
+    {
+    }
+
+    void operator()(error_code ec, Args... args)
+    {
+      if (ec == boost::asio::error::operation_aborted && state_->timed_out_)
+        ec = boost::asio::error::timed_out;
+      this->store(ec, std::forward<Args>(args)...);
+
+      error_code ignored;
+      state_->timer_.cancel(ignored);
+      state_->complete(this->waiter_);
+    }
+
+    IoObject* object_;
+    std::chrono::steady_clock::duration timeout_;
+    await_timeout_state<IoObject>* state_ = nullptr;
+  };
+
   template <class... T>
   inline std::tuple<T...> get_await_result(std::tuple<T...>& result)
   {
@@ -130,13 +292,57 @@ public:
 
   resumable type get()
   {
-    rexp::waiter::active()->suspend();
+    rexp::waiter::active()->suspend("asynchronous operation");
+    if (exception_)
+      std::rethrow_exception(exception_);
+    return rexp::detail::get_await_result(result_.get());
+  }
+
+private:
+  boost::optional<tuple_type> result_;
+  std::exception_ptr exception_;
+};
+
+template <class IoObject, class R, class... Args>
+struct handler_type<rexp::use_await_timeout_t<IoObject>,
+    R(boost::system::error_code, Args...)>
+{
+  typedef rexp::detail::await_timeout_handler<IoObject, Args...> type;
+};
+
+template <class IoObject, class... Args>
+class async_result<rexp::detail::await_timeout_handler<IoObject, Args...>>
+{
+public:
+  typedef rexp::detail::await_timeout_handler<IoObject, Args...> handler_type;
+  typedef typename handler_type::tuple_type tuple_type;
+  typedef decltype(rexp::detail::get_await_result(std::declval<tuple_type&>())) type;
+
+  explicit async_result(handler_type& handler)
+    : state_(*handler.object_)
+  {
+    assert(rexp::waiter::active() != nullptr);
+    handler.waiter_ = rexp::waiter::active()->shared_from_this();
+    handler.result_ = &result_;
+    handler.exception_ = &exception_;
+    handler.state_ = &state_;
+
+    state_.timer_.expires_from_now(handler.timeout_);
+    state_.timer_.async_wait(
+        rexp::detail::await_deadline_handler<IoObject>{
+          handler.waiter_, &state_});
+  }
+
+  resumable type get()
+  {
+    rexp::waiter::active()->suspend("asynchronous operation with timeout");
     if (exception_)
       std::rethrow_exception(exception_);
     return rexp::detail::get_await_result(result_.get());
   }
 
 private:
+  rexp::detail::await_timeout_state<IoObject> state_;
   boost::optional<tuple_type> result_;
   std::exception_ptr exception_;
 };
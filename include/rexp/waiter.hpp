@@ -12,38 +12,122 @@
 #ifndef RESUMABLE_EXPRESSIONS_WAITER_HPP
 #define RESUMABLE_EXPRESSIONS_WAITER_HPP
 
+#include <atomic>
 #include <cassert>
+#include <cstddef>
 #include <memory>
-#include <mutex>
+#include "rexp/detail/handler_memory.hpp"
 #include "rexp/resumable.hpp"
+#include "rexp/scheduler.hpp"
+#include "rexp/trace.hpp"
+
+#if defined(REXP_ENABLE_WAITER_REGISTRY)
+# include <chrono>
+# include <mutex>
+# include <typeinfo>
+#endif
 
 namespace rexp {
 
+class waiter;
+class waiter_registry;
+
+#if defined(REXP_ENABLE_WAITER_REGISTRY)
+namespace detail
+{
+  struct waiter_list
+  {
+    std::mutex mutex_;
+    waiter* head_ = nullptr;
+
+    static waiter_list& instance()
+    {
+      static waiter_list l;
+      return l;
+    }
+  };
+} // namespace detail
+#endif
+
 class waiter :
   public std::enable_shared_from_this<waiter>
 {
 public:
+#if defined(REXP_ENABLE_WAITER_REGISTRY)
+  waiter()
+  {
+    detail::waiter_list& l = detail::waiter_list::instance();
+    std::lock_guard<std::mutex> lock(l.mutex_);
+    registry_next_ = l.head_;
+    if (l.head_)
+      l.head_->registry_prev_ = this;
+    l.head_ = this;
+  }
+
+  virtual ~waiter()
+  {
+    detail::waiter_list& l = detail::waiter_list::instance();
+    std::lock_guard<std::mutex> lock(l.mutex_);
+    if (registry_prev_)
+      registry_prev_->registry_next_ = registry_next_;
+    else
+      l.head_ = registry_next_;
+    if (registry_next_)
+      registry_next_->registry_prev_ = registry_prev_;
+  }
+#else
+  waiter() {}
   virtual ~waiter() {}
+#endif
 
+  // Runs the waiter until it suspends or completes. Only the thread that
+  // moved the waiter into the running state may call this.
   void run()
   {
-    struct state_saver
+    struct depth_saver
     {
-      waiter* prev = active_waiter_;
-      ~state_saver() { active_waiter_ = prev; }
-    } saver;
-    active_waiter_ = this;
+      depth_saver() { ++run_depth_; }
+      ~depth_saver() { --run_depth_; }
+    } depth;
+
+    execute();
 
-    std::lock_guard<std::mutex> lock(mutex_);
-    nested_resumption_ = false;
-    do_run();
+    // The outermost run on this thread drains the waiters that were resumed
+    // from further up the stack, so that chains of synchronous completions
+    // are run iteratively instead of recursively.
+    if (run_depth_ == 1)
+    {
+      while (waiter* w = ready_head_)
+      {
+        ready_head_ = w->next_ready_;
+        if (!ready_head_)
+          ready_tail_ = nullptr;
+        w->next_ready_ = nullptr;
+        std::shared_ptr<waiter> keep_alive(std::move(w->self_));
+        w->execute();
+      }
+    }
   }
 
-  resumable void suspend()
+  // The description of what the waiter is waiting for should be a string
+  // literal. It is shown by the waiter registry, when enabled.
+  resumable void suspend(const char* awaiting = "unknown")
   {
     assert(active_waiter_ == this);
-    if (!nested_resumption_)
+    REXP_TRACE_EVENT(waiter_suspend, this);
+
+    state expected = resume_pending;
+    if (!state_.compare_exchange_strong(expected, running,
+          std::memory_order_acquire))
     {
+#if defined(REXP_ENABLE_WAITER_REGISTRY)
+      awaiting_.store(awaiting, std::memory_order_relaxed);
+      suspended_at_.store(
+          std::chrono::steady_clock::now().time_since_epoch().count(),
+          std::memory_order_relaxed);
+#else
+      (void)awaiting;
+#endif
       active_waiter_ = nullptr;
       break_resumable;
     }
@@ -51,10 +135,63 @@ public:
 
   void resume()
   {
-    if (active_waiter_ == this)
-      nested_resumption_ = true;
-    else
-      run();
+    REXP_TRACE_EVENT(waiter_resume, this);
+
+    state s = state_.load(std::memory_order_acquire);
+    for (;;)
+    {
+      if (s == suspended)
+      {
+        if (state_.compare_exchange_weak(s, running,
+              std::memory_order_acq_rel))
+        {
+          if (scheduler_)
+            scheduler_->schedule(shared_from_this());
+          else if (run_depth_ > 0)
+            push_ready();
+          else
+            run();
+          return;
+        }
+      }
+      else if (s == running)
+      {
+        if (state_.compare_exchange_weak(s, resume_pending,
+              std::memory_order_acq_rel))
+          return;
+      }
+      else
+      {
+        return;
+      }
+    }
+  }
+
+  rexp::scheduler* get_scheduler() const noexcept
+  {
+    return scheduler_;
+  }
+
+  void set_scheduler(rexp::scheduler* s) noexcept
+  {
+    scheduler_ = s;
+  }
+
+  // Memory for the state of asynchronous operations awaited by this waiter.
+  detail::handler_memory& handler_memory() noexcept
+  {
+    return handler_memory_;
+  }
+
+  // Labels should be string literals or otherwise outlive the waiter.
+  const char* label() const noexcept
+  {
+    return label_.load(std::memory_order_relaxed);
+  }
+
+  void set_label(const char* l) noexcept
+  {
+    label_.store(l, std::memory_order_relaxed);
   }
 
   static waiter* active()
@@ -63,11 +200,85 @@ public:
   }
 
 private:
-  virtual void do_run() = 0;
+  friend class waiter_registry;
+
+  virtual bool do_run() = 0;
+
+  void push_ready()
+  {
+    self_ = shared_from_this();
+    if (ready_tail_)
+      ready_tail_->next_ready_ = this;
+    else
+      ready_head_ = this;
+    ready_tail_ = this;
+  }
+
+  void execute()
+  {
+    struct state_saver
+    {
+      waiter* prev = active_waiter_;
+      ~state_saver() { active_waiter_ = prev; }
+    } saver;
+
+    for (;;)
+    {
+      active_waiter_ = this;
+      REXP_TRACE_EVENT(waiter_run_begin, this);
+
+      bool complete;
+      try
+      {
+        complete = do_run();
+      }
+      catch (...)
+      {
+        REXP_TRACE_EVENT(waiter_run_end, this);
+        state_.store(idle, std::memory_order_release);
+        throw;
+      }
+
+      REXP_TRACE_EVENT(waiter_run_end, this);
 
-  std::mutex mutex_;
-  bool nested_resumption_ = false;
+      if (complete)
+      {
+        state_.store(idle, std::memory_order_release);
+        return;
+      }
+
+      // The coroutine has now switched out, so it is safe for another thread
+      // to pick it up. If a resume arrived in the meantime, keep going.
+      state expected = running;
+      if (state_.compare_exchange_strong(expected, suspended,
+            std::memory_order_acq_rel))
+        return;
+
+      state_.store(running, std::memory_order_relaxed);
+    }
+  }
+
+  // A waiter starts out running. Resuming a running waiter leaves the resume
+  // pending, to be picked up by the running thread before it suspends.
+  // Completed waiters are idle and ignore resumption.
+  enum state { idle, running, resume_pending, suspended };
+
+  std::atomic<state> state_{running};
+  rexp::scheduler* scheduler_ = nullptr;
+  waiter* next_ready_ = nullptr;
+  std::shared_ptr<waiter> self_;
+  std::atomic<const char*> label_{nullptr};
+  detail::handler_memory handler_memory_;
+#if defined(REXP_ENABLE_WAITER_REGISTRY)
+  waiter* registry_prev_ = nullptr;
+  waiter* registry_next_ = nullptr;
+  std::atomic<const char*> awaiting_{nullptr};
+  std::atomic<std::chrono::steady_clock::rep> suspended_at_{0};
+#endif
   static __thread waiter* active_waiter_;
+  static __thread waiter* ready_head_;
+  static __thread waiter* ready_tail_;
+  static __thread std::size_t run_depth_;
 };
 
 namespace detail
@@ -80,13 +291,27 @@ namespace detail
       f_(std::move(f)),
       r_([f = &f_]{ (*f)(); })
     {
+#if defined(REXP_ENABLE_WAITER_REGISTRY)
+      set_label(typeid(F).name());
+#endif
+    }
+
+    template <class Allocator>
+    waiter_impl(std::allocator_arg_t, const Allocator& a, F f) :
+      f_(std::move(f)),
+      r_(std::allocator_arg, a, [f = &f_]{ (*f)(); })
+    {
+#if defined(REXP_ENABLE_WAITER_REGISTRY)
+      set_label(typeid(F).name());
+#endif
     }
 
   private:
-    virtual void do_run()
+    virtual bool do_run()
     {
       while (active() == this && !r_.ready())
         r_.resume();
+      return r_.ready();
     }
 
     F f_;
@@ -97,7 +322,37 @@ namespace detail
 template <class F>
 void launch_waiter(F f)
 {
-  std::make_shared<detail::waiter_impl<F>>(std::move(f))->run();
+  auto w = std::make_shared<detail::waiter_impl<F>>(std::move(f));
+  REXP_TRACE_EVENT(waiter_launch, w.get());
+  w->run();
+}
+
+template <class F>
+void launch_waiter(scheduler& s, F f)
+{
+  auto w = std::make_shared<detail::waiter_impl<F>>(std::move(f));
+  REXP_TRACE_EVENT(waiter_launch, w.get());
+  w->set_scheduler(&s);
+  s.schedule(std::move(w));
+}
+
+template <class Allocator, class F>
+void launch_waiter(std::allocator_arg_t, const Allocator& a, F f)
+{
+  auto w = std::allocate_shared<detail::waiter_impl<F>>(
+      a, std::allocator_arg, a, std::move(f));
+  REXP_TRACE_EVENT(waiter_launch, w.get());
+  w->run();
+}
+
+template <class Allocator, class F>
+void launch_waiter(scheduler& s, std::allocator_arg_t, const Allocator& a, F f)
+{
+  auto w = std::allocate_shared<detail::waiter_impl<F>>(
+      a, std::allocator_arg, a, std::move(f));
+  REXP_TRACE_EVENT(waiter_launch, w.get());
+  w->set_scheduler(&s);
+  s.schedule(std::move(w));
 }
 
 } // namespace rexp
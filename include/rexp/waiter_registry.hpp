@@ -0,0 +1,126 @@
+//
+// waiter_registry.hpp
+// ~~~~~~~~~~~~~~~~~~~
+// Enumeration of live waiters for diagnosing stalls.
+//
+// Copyright (c) 2015 Christopher M. Kohlhoff (chris at kohlhoff dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef RESUMABLE_EXPRESSIONS_WAITER_REGISTRY_HPP
+#define RESUMABLE_EXPRESSIONS_WAITER_REGISTRY_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "rexp/waiter.hpp"
+
+#if defined(__GNUC__)
+# include <cxxabi.h>
+#endif
+
+namespace rexp {
+
+struct waiter_info
+{
+  const void* id;
+  std::string label;
+  const char* state;
+  const char* awaiting;
+  std::chrono::steady_clock::duration suspended_for;
+};
+
+// Waiters are only registered when REXP_ENABLE_WAITER_REGISTRY is defined.
+// Otherwise the registry is always empty.
+class waiter_registry
+{
+public:
+  // Returns the live waiters, longest-suspended first.
+  static std::vector<waiter_info> snapshot()
+  {
+    std::vector<waiter_info> result;
+
+#if defined(REXP_ENABLE_WAITER_REGISTRY)
+    static const char* const state_names[] =
+    {
+      "idle", "running", "resume pending", "suspended"
+    };
+
+    auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+
+    detail::waiter_list& l = detail::waiter_list::instance();
+    std::lock_guard<std::mutex> lock(l.mutex_);
+    for (waiter* w = l.head_; w; w = w->registry_next_)
+    {
+      waiter::state s = w->state_.load(std::memory_order_relaxed);
+      waiter_info info;
+      info.id = w;
+      info.label = demangle(w->label());
+      info.state = state_names[s];
+      info.awaiting = s == waiter::suspended
+        ? w->awaiting_.load(std::memory_order_relaxed) : "";
+      info.suspended_for = s == waiter::suspended
+        ? std::chrono::steady_clock::duration(
+            now - w->suspended_at_.load(std::memory_order_relaxed))
+        : std::chrono::steady_clock::duration::zero();
+      result.push_back(std::move(info));
+    }
+#endif
+
+    std::stable_sort(result.begin(), result.end(),
+        [](const waiter_info& a, const waiter_info& b)
+        {
+          return a.suspended_for > b.suspended_for;
+        });
+
+    return result;
+  }
+
+  // Writes one line for each of the max longest-suspended waiters.
+  static void dump(std::ostream& os, std::size_t max = 20)
+  {
+    std::vector<waiter_info> waiters = snapshot();
+    os << waiters.size() << " live waiters\n";
+    for (std::size_t i = 0; i < waiters.size() && i < max; ++i)
+    {
+      const waiter_info& w = waiters[i];
+      os << w.id << ' ' << w.state;
+      if (*w.awaiting)
+      {
+        os << " on " << w.awaiting << " for "
+          << std::chrono::duration_cast<std::chrono::milliseconds>(
+              w.suspended_for).count() << "ms";
+      }
+      os << ": " << w.label << '\n';
+    }
+  }
+
+private:
+  static std::string demangle(const char* name)
+  {
+    if (!name)
+      return "(unlabelled)";
+
+#if defined(__GNUC__)
+    int status = 0;
+    std::unique_ptr<char, void (*)(void*)> demangled(
+        abi::__cxa_demangle(name, nullptr, nullptr, &status), std::free);
+    if (status == 0 && demangled)
+      return demangled.get();
+#endif
+
+    return name;
+  }
+};
+
+} // namespace rexp
+
+#endif // RESUMABLE_EXPRESSIONS_WAITER_REGISTRY_HPP
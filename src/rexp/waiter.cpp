@@ -14,5 +14,8 @@
 namespace rexp {
 
 __thread waiter* waiter::active_waiter_;
+__thread waiter* waiter::ready_head_;
+__thread waiter* waiter::ready_tail_;
+__thread std::size_t waiter::run_depth_;
 
 } // namespace rexp